@@ -6,21 +6,121 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/fault-inject.h>
 #include <linux/hid.h>
 #include <linux/hwmon.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
 #include <linux/spinlock.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <asm/unaligned.h>
 
+#define CREATE_TRACE_POINTS
+#include "gigabyte_waterforce_trace.h"
+
 #define DRIVER_NAME	"gigabyte_waterforce"
 
 #define USB_VENDOR_ID_GIGABYTE		0x1044
 #define USB_PRODUCT_ID_WATERFORCE	0x7a4d	/* Gigabyte AORUS WATERFORCE X240, X280 and X360 */
 
-#define STATUS_VALIDITY		(2 * 1000)	/* ms */
+#define STATUS_VALIDITY		(2 * 1000)	/* ms, default */
+#define REQUEST_TIMEOUT		(2 * 1000)	/* ms, default */
+#define MAX_TIMING_SETTING	(60 * 1000)	/* ms */
+
+#define HISTORY_LENGTH		256	/* Status reports kept for the history debugfs entry */
+#define HISTORY_LINE_LENGTH	80
+#define STATUS_LINE_LENGTH	256
+#define STATUS_RAW_LENGTH	64	/* Leading bytes of the status report kept as received */
+
+#define RTT_HISTOGRAM_BUCKETS	24	/* Powers of two in us, the last one also holds the rest */
 #define MAX_REPORT_LENGTH	6144
 
+static unsigned int poll_interval;
+module_param(poll_interval, uint, 0444);
+MODULE_PARM_DESC(poll_interval,
+		 "Interval in ms for polling the device status in the background (0 = disabled)");
+
+static unsigned int adaptive_temp_delta = 1000;
+module_param(adaptive_temp_delta, uint, 0644);
+MODULE_PARM_DESC(adaptive_temp_delta,
+		 "Change in coolant temp (in millidegrees) between reports that makes an adaptive "
+		 "poller speed up");
+
+static unsigned int adaptive_rpm_delta = 100;
+module_param(adaptive_rpm_delta, uint, 0644);
+MODULE_PARM_DESC(adaptive_rpm_delta,
+		 "Change in fan or pump speed (in RPM) between reports that makes an adaptive "
+		 "poller speed up");
+
+static bool descriptor_report_length = true;
+module_param(descriptor_report_length, bool, 0444);
+MODULE_PARM_DESC(descriptor_report_length,
+		 "Send output reports sized as declared by the HID descriptor instead of "
+		 __stringify(MAX_REPORT_LENGTH) " bytes (default on)");
+
+static unsigned int notify_interval = 1000;
+module_param(notify_interval, uint, 0644);
+MODULE_PARM_DESC(notify_interval,
+		 "Minimum interval in ms between sysfs change notifications (0 = disabled)");
+
+static bool passive;
+module_param(passive, bool, 0644);
+MODULE_PARM_DESC(passive,
+		 "Wait for status reports requested by other users (e.g. through hidraw) instead of "
+		 "sending a duplicate request, while they keep arriving");
+
+static unsigned int timeout_threshold = 3;
+module_param(timeout_threshold, uint, 0644);
+MODULE_PARM_DESC(timeout_threshold,
+		 "Consecutive timeouts after which the last values are served as faulty, while "
+		 "requests back off (0 = disabled)");
+
+static unsigned int status_resends = 2;
+module_param(status_resends, uint, 0644);
+MODULE_PARM_DESC(status_resends,
+		 "Times an unanswered status request is sent again before it times out, in case it "
+		 "got lost among commands of other users");
+
+static unsigned int temp_filter_shift;
+module_param(temp_filter_shift, uint, 0444);
+MODULE_PARM_DESC(temp_filter_shift,
+		 "Weight of new readings in the filtered coolant temp, as 1 / 2^shift (0 = disabled, max 8)");
+
+static unsigned int temp_deadband;
+module_param(temp_deadband, uint, 0644);
+MODULE_PARM_DESC(temp_deadband,
+		 "Change in coolant temp (in millidegrees) that must be exceeded for a report to "
+		 "count as changed");
+
+static unsigned int fan_deadband;
+module_param(fan_deadband, uint, 0644);
+MODULE_PARM_DESC(fan_deadband,
+		 "Change in fan speed (in RPM) that must be exceeded for a report to count as changed");
+
+static unsigned int pump_deadband;
+module_param(pump_deadband, uint, 0644);
+MODULE_PARM_DESC(pump_deadband,
+		 "Change in pump speed (in RPM) that must be exceeded for a report to count as "
+		 "changed");
+
+static unsigned int duty_deadband;
+module_param(duty_deadband, uint, 0644);
+MODULE_PARM_DESC(duty_deadband,
+		 "Change in fan or pump duty (in %) that must be exceeded for a report to count as "
+		 "changed");
+
 #define WATERFORCE_TEMP_SENSOR	0xD
 #define WATERFORCE_FAN_SPEED	0x02
 #define WATERFORCE_PUMP_SPEED	0x05
@@ -28,18 +128,27 @@
 #define WATERFORCE_PUMP_DUTY	0x09
 
 /* Control commands, inner offsets and lengths */
-static const u8 get_status_cmd[] = { 0x99, 0xDA };
+#define WATERFORCE_CMD_PREFIX		0x99
+#define WATERFORCE_OPCODE_OFFSET	1
+
+#define GET_STATUS_OPCODE		0xDA
+static const u8 get_status_cmd[] = { WATERFORCE_CMD_PREFIX, GET_STATUS_OPCODE };
 
 #define FIRMWARE_VER_START_OFFSET_1	2
 #define FIRMWARE_VER_START_OFFSET_2	3
-static const u8 get_firmware_ver_cmd[] = { 0x99, 0xD6 };
+#define GET_FIRMWARE_VER_OPCODE		0xD6
+static const u8 get_firmware_ver_cmd[] = { WATERFORCE_CMD_PREFIX, GET_FIRMWARE_VER_OPCODE };
 
 /* Command lengths */
 #define GET_STATUS_CMD_LENGTH		2
 #define GET_FIRMWARE_VER_CMD_LENGTH	2
 
+#define TEMP_FILTER_SHIFT_MAX		8
+#define TEMP_FILTER_FRAC_BITS		8	/* Fractional bits of the filter state */
+
 static const char *const waterforce_temp_label[] = {
-	"Coolant temp"
+	"Coolant temp",
+	"Coolant temp (filtered)"
 };
 
 static const char *const waterforce_speed_label[] = {
@@ -47,37 +156,206 @@ static const char *const waterforce_speed_label[] = {
 	"Pump speed"
 };
 
+/* Sensor data parsed from a single status report */
+struct waterforce_status {
+	s32 temp_input[2];	/* Coolant temp and its filtered value */
+	s32 temp_rate;		/* Rate of change of the coolant temp, in millidegrees/s */
+	u16 speed_input[2];	/* Fan and pump speed in RPM */
+	u8 duty_input[2];	/* Fan and pump duty in 0-100% */
+	unsigned long updated;	/* jiffies */
+	u64 timestamp;		/* ns, monotonic */
+	u64 generation;		/* Bumped by reports that changed the values */
+	u64 seq;		/* Bumped by every report */
+	bool valid;		/* Set once the first report arrives */
+};
+
+enum waterforce_stat {
+	WATERFORCE_STAT_REQUESTS_SENT,
+	WATERFORCE_STAT_RESENDS,
+	WATERFORCE_STAT_COALESCED,
+	WATERFORCE_STAT_TIMEOUTS,
+	WATERFORCE_STAT_INTERRUPTED,
+	WATERFORCE_STAT_BREAKER_TRIPS,
+	WATERFORCE_STAT_COUNT
+};
+
+static const char *const waterforce_stat_names[] = {
+	[WATERFORCE_STAT_REQUESTS_SENT] = "requests_sent",
+	[WATERFORCE_STAT_RESENDS] = "resends",
+	[WATERFORCE_STAT_COALESCED] = "coalesced",
+	[WATERFORCE_STAT_TIMEOUTS] = "timeouts",
+	[WATERFORCE_STAT_INTERRUPTED] = "interrupted",
+	[WATERFORCE_STAT_BREAKER_TRIPS] = "breaker_trips",
+};
+
+/* Request counters and round-trip times of replies to the driver's own commands */
+struct waterforce_stats {
+	u64 count[WATERFORCE_STAT_COUNT];
+	u64 rtt_count;
+	u64 rtt_sum;	/* ns */
+	u64 rtt_min;	/* ns */
+	u64 rtt_max;	/* ns */
+	u64 power_up_max;	/* ns, includes resuming the device */
+	u64 rtt_histogram[RTT_HISTOGRAM_BUCKETS];
+};
+
+/*
+ * Counters of sysfs reads, kept per CPU as those can come from many collectors at once. Hits
+ * are served from the cached status, misses waited on a report and errors failed.
+ */
+struct waterforce_read_stats {
+	u64_stats_t hits;
+	u64_stats_t misses;
+	u64_stats_t errors;
+	struct u64_stats_sync syncp;
+};
+
+/*
+ * Devices with the poller enabled, whose polls are all dispatched from waterforce_poll_work.
+ * Polls coming due within a short window of each other are sent together, so that the
+ * devices are refreshed in one go instead of each waking the system up on its own.
+ */
+static LIST_HEAD(waterforce_pollers);
+/* For locking access to waterforce_pollers and the scheduling state of its devices */
+static DEFINE_MUTEX(waterforce_pollers_lock);
+static void waterforce_poll_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(waterforce_poll_work, waterforce_poll_work_fn);
+
 struct waterforce_data {
 	struct hid_device *hdev;
 	struct device *hwmon_dev;
 	struct dentry *debugfs;
 	/* For locking access to buffer */
 	struct mutex buffer_lock;
-	/* For queueing multiple readers */
-	struct mutex status_report_request_mutex;
-	/* For reinitializing the completion below */
+	/* For coalescing concurrent status requests into the one in flight */
 	spinlock_t status_report_request_lock;
 	struct completion status_report_received;
+	bool status_request_pending;
+	bool status_request_sent;	/* Otherwise only listening, in passive mode */
+	unsigned long status_request_deadline;	/* jiffies */
+	int status_request_result;
+	ktime_t status_request_sent_at;
+	bool external_report_seen;
+	unsigned long last_external_report;	/* jiffies */
+	/* For backing off from an unresponsive device, also protected by the lock above */
+	unsigned int consecutive_timeouts;
+	bool breaker_tripped;		/* Stale values are served as faulty while set */
+	unsigned long breaker_until;	/* jiffies, no requests are sent before this */
+	unsigned int breaker_backoff;	/* ms */
 	struct completion fw_version_processed;
-
-	/* Sensor data */
-	s32 temp_input[1];
-	u16 speed_input[2];	/* Fan and pump speed in RPM */
-	u8 duty_input[2];	/* Fan and pump duty in 0-100% */
-
-	u8 *buffer;
+	ktime_t fw_request_sent_at;
+	/* For querying the firmware version without holding up probe */
+	struct work_struct fw_work;
+	/* For refreshing the status in the background, if enabled */
+	struct work_struct status_work;
+	struct list_head poll_node;	/* In waterforce_pollers */
+	unsigned long poll_started;	/* jiffies, when the latest poll was dispatched */
+	unsigned long next_poll;	/* jiffies */
+	bool poll_busy;			/* Set while status_work is queued or running */
+	unsigned int poll_interval;	/* ms, current one, 0 if disabled */
+	/* Bounds for adapting the poll interval to thermal activity, if they differ */
+	unsigned int poll_interval_min;	/* ms */
+	unsigned int poll_interval_max;	/* ms */
+	bool poll_activity;		/* Set by reports that moved enough */
+	/* Timing settings adjustable through sysfs */
+	unsigned int update_interval;	/* ms, for how long a status report is cached */
+	unsigned int request_timeout;	/* ms, for how long to wait on a reply */
+	/* For notifying sysfs readers of changed values, rate limited */
+	struct delayed_work notify_work;
+	bool notify_enabled;		/* Protected by status_report_request_lock */
+	unsigned long next_notify;	/* jiffies */
+	struct waterforce_status notified;	/* Values as of the last notification */
+
+	/* Sensor data, written only by waterforce_raw_event() */
+	seqlock_t status_lock;
+	struct waterforce_status status;
+	s32 temp_filter;	/* Filtered coolant temp, with TEMP_FILTER_FRAC_BITS */
+	/* The latest status report as received, for fields not decoded by the driver */
+	u8 status_raw[STATUS_RAW_LENGTH];
+	u8 status_raw_length;
+	/* Ring of the most recent reports, also protected by status_lock */
+	struct waterforce_status *history;
+	u64 history_head;	/* Count of reports ever stored */
+	wait_queue_head_t history_wait;
+	wait_queue_head_t sample_wait;	/* Woken by every report, changed or not */
+	bool removed;		/* For waking history readers when the device goes away */
+
+	/* For instrumenting the requests */
+	spinlock_t stats_lock;
+	struct waterforce_stats stats;
+	struct waterforce_read_stats __percpu *read_stats;
+
+	u8 *buffer;		/* output_report_length long, kept zeroed past the command bytes */
+	size_t output_report_length;
 	int firmware_version;
-	unsigned long updated;	/* jiffies */
+
+#ifdef CONFIG_FAULT_INJECTION_DEBUG_FS
+	/* For exercising the error paths, configured through debugfs */
+	struct fault_attr fail_output;	/* Fails sending commands */
+	struct fault_attr fail_reply;	/* Drops incoming reports */
+#endif
 };
 
+#ifdef CONFIG_FAULT_INJECTION_DEBUG_FS
+static DECLARE_FAULT_ATTR(waterforce_fail_default);
+
+static void waterforce_fault_init(struct waterforce_data *priv)
+{
+	priv->fail_output = waterforce_fail_default;
+	priv->fail_reply = waterforce_fail_default;
+}
+
+static void waterforce_fault_debugfs_init(struct waterforce_data *priv)
+{
+	fault_create_debugfs_attr("fail_output", priv->debugfs, &priv->fail_output);
+	fault_create_debugfs_attr("fail_reply", priv->debugfs, &priv->fail_reply);
+}
+
+static bool waterforce_fail_output(struct waterforce_data *priv, int length)
+{
+	return should_fail(&priv->fail_output, length);
+}
+
+static bool waterforce_fail_reply(struct waterforce_data *priv, int size)
+{
+	return should_fail(&priv->fail_reply, size);
+}
+#else
+static void waterforce_fault_init(struct waterforce_data *priv) { }
+static void waterforce_fault_debugfs_init(struct waterforce_data *priv) { }
+
+static bool waterforce_fail_output(struct waterforce_data *priv, int length)
+{
+	return false;
+}
+
+static bool waterforce_fail_reply(struct waterforce_data *priv, int size)
+{
+	return false;
+}
+#endif
+
 static umode_t waterforce_is_visible(const void *data,
 				     enum hwmon_sensor_types type, u32 attr, int channel)
 {
 	switch (type) {
+	case hwmon_chip:
+		switch (attr) {
+		case hwmon_chip_update_interval:
+			return 0644;
+		default:
+			break;
+		}
+		break;
 	case hwmon_temp:
+		/* The filtered coolant temp is there only if enabled */
+		if (channel == 1 && !temp_filter_shift)
+			break;
+
 		switch (attr) {
 		case hwmon_temp_label:
 		case hwmon_temp_input:
+		case hwmon_temp_fault:
 			return 0444;
 		default:
 			break;
@@ -87,6 +365,7 @@ static umode_t waterforce_is_visible(const void *data,
 		switch (attr) {
 		case hwmon_fan_label:
 		case hwmon_fan_input:
+		case hwmon_fan_fault:
 			return 0444;
 		default:
 			break;
@@ -107,80 +386,463 @@ static umode_t waterforce_is_visible(const void *data,
 	return 0;
 }
 
-/* Writes the command to the device with the rest of the report filled with zeroes */
+/*
+ * Writes the command to the device with the rest of the report filled with zeroes. As the
+ * buffer is zeroed on allocation and cleared again after each command, only the command
+ * bytes themselves need to be touched.
+ */
 static int waterforce_write_expanded(struct waterforce_data *priv, const u8 *cmd, int cmd_length)
 {
 	int ret;
 
+	if (waterforce_fail_output(priv, cmd_length))
+		return -EIO;
+
 	mutex_lock(&priv->buffer_lock);
 
-	memcpy_and_pad(priv->buffer, MAX_REPORT_LENGTH, cmd, cmd_length, 0x00);
-	ret = hid_hw_output_report(priv->hdev, priv->buffer, MAX_REPORT_LENGTH);
+	memcpy(priv->buffer, cmd, cmd_length);
+	trace_waterforce_cmd_submit(priv->hdev, cmd[WATERFORCE_OPCODE_OFFSET],
+				    priv->output_report_length);
+	ret = hid_hw_output_report(priv->hdev, priv->buffer, priv->output_report_length);
+	trace_waterforce_cmd_done(priv->hdev, cmd[WATERFORCE_OPCODE_OFFSET], ret);
+	memset(priv->buffer, 0x00, cmd_length);
 
 	mutex_unlock(&priv->buffer_lock);
 	return ret;
 }
 
-static int waterforce_get_status(struct waterforce_data *priv)
+/* Copies out a consistent view of the sensor data, without blocking the writer */
+static void waterforce_get_snapshot(struct waterforce_data *priv, struct waterforce_status *status)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&priv->status_lock);
+		*status = priv->status;
+	} while (read_seqretry(&priv->status_lock, seq));
+}
+
+static unsigned long waterforce_last_updated(struct waterforce_data *priv)
+{
+	return READ_ONCE(priv->status.updated);
+}
+
+/*
+ * Returns for how long (in ms) the cached sensor data may be served by waterforce_read().
+ * With the background poller running, data is allowed to be one poll period older.
+ */
+static unsigned int waterforce_status_lifetime(struct waterforce_data *priv)
+{
+	return READ_ONCE(priv->poll_interval_max) + READ_ONCE(priv->update_interval);
+}
+
+/* Checks against the current settings, so that changing them takes effect immediately */
+static bool waterforce_status_fresh(struct waterforce_data *priv, unsigned int validity)
+{
+	return READ_ONCE(priv->status.valid) &&
+	       !time_after(jiffies, waterforce_last_updated(priv) + msecs_to_jiffies(validity));
+}
+
+static void waterforce_count(struct waterforce_data *priv, enum waterforce_stat stat)
 {
-	int ret = mutex_lock_interruptible(&priv->status_report_request_mutex);
+	unsigned long flags;
 
+	spin_lock_irqsave(&priv->stats_lock, flags);
+	priv->stats.count[stat]++;
+	spin_unlock_irqrestore(&priv->stats_lock, flags);
+}
+
+static void waterforce_record_rtt(struct waterforce_data *priv, ktime_t sent_at)
+{
+	u64 rtt = ktime_to_ns(ktime_sub(ktime_get(), sent_at));
+	struct waterforce_stats *stats = &priv->stats;
+	u64 rtt_us = div_u64(rtt, NSEC_PER_USEC);
+	unsigned long flags;
+	int bucket;
+
+	bucket = rtt_us ? min(ilog2(rtt_us), RTT_HISTOGRAM_BUCKETS - 1) : 0;
+
+	spin_lock_irqsave(&priv->stats_lock, flags);
+	if (!stats->rtt_count || rtt < stats->rtt_min)
+		stats->rtt_min = rtt;
+	if (rtt > stats->rtt_max)
+		stats->rtt_max = rtt;
+	stats->rtt_sum += rtt;
+	stats->rtt_count++;
+	stats->rtt_histogram[bucket]++;
+	spin_unlock_irqrestore(&priv->stats_lock, flags);
+}
+
+/*
+ * Keeps the device resumed while the driver sends commands to it or waits on its replies, as
+ * the output path of usbhid doesn't resume it on its own. In between, it may be autosuspended
+ * as configured through its USB power attributes. Resuming is done before any request timeout
+ * starts running.
+ */
+static int waterforce_hw_get(struct waterforce_data *priv)
+{
+	ktime_t start = ktime_get();
+	u64 elapsed;
+	int ret;
+
+	ret = hid_hw_power(priv->hdev, PM_HINT_FULLON);
 	if (ret < 0)
 		return ret;
 
-	if (!time_after(jiffies, priv->updated + msecs_to_jiffies(STATUS_VALIDITY))) {
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_lock_irq(&priv->stats_lock);
+	priv->stats.power_up_max = max(priv->stats.power_up_max, elapsed);
+	spin_unlock_irq(&priv->stats_lock);
+
+	return 0;
+}
+
+static void waterforce_hw_put(struct waterforce_data *priv)
+{
+	hid_hw_power(priv->hdev, PM_HINT_NORMAL);
+}
+
+/*
+ * Trips the breaker once enough requests in a row went unanswered. Further requests are then
+ * held back for an exponentially growing period, while reads are served the last values as
+ * faulty instead of each waiting out the timeout. A request that times out after the period
+ * ends trips it again, while any report arriving resets it.
+ */
+static void waterforce_breaker_timeout(struct waterforce_data *priv)
+{
+	unsigned int threshold = READ_ONCE(timeout_threshold);
+
+	lockdep_assert_held(&priv->status_report_request_lock);
+
+	priv->consecutive_timeouts++;
+	if (!threshold || priv->consecutive_timeouts < threshold)
+		return;
+
+	if (priv->breaker_backoff)
+		priv->breaker_backoff = min_t(unsigned int, priv->breaker_backoff * 2,
+					      MAX_TIMING_SETTING);
+	else
+		priv->breaker_backoff = READ_ONCE(priv->request_timeout);
+	WRITE_ONCE(priv->breaker_until, jiffies + msecs_to_jiffies(priv->breaker_backoff));
+
+	if (!priv->breaker_tripped) {
+		WRITE_ONCE(priv->breaker_tripped, true);
+		waterforce_count(priv, WATERFORCE_STAT_BREAKER_TRIPS);
+		/* Ratelimited, as a flapping link would otherwise flood the log */
+		dev_warn_ratelimited(&priv->hdev->dev,
+				     "device not responding, serving last values as faulty\n");
+	}
+}
+
+static void waterforce_breaker_reset(struct waterforce_data *priv)
+{
+	lockdep_assert_held(&priv->status_report_request_lock);
+
+	priv->consecutive_timeouts = 0;
+	priv->breaker_backoff = 0;
+	if (priv->breaker_tripped) {
+		WRITE_ONCE(priv->breaker_tripped, false);
+		dev_info_ratelimited(&priv->hdev->dev, "device responding again\n");
+	}
+}
+
+/* Ends the pending status request, waking up everyone waiting on it */
+static void waterforce_finish_status_request(struct waterforce_data *priv, int result)
+{
+	lockdep_assert_held(&priv->status_report_request_lock);
+
+	if (result == -ETIMEDOUT) {
+		waterforce_count(priv, WATERFORCE_STAT_TIMEOUTS);
+		waterforce_breaker_timeout(priv);
+	}
+
+	priv->status_request_pending = false;
+	priv->status_request_result = result;
+	trace_waterforce_status_complete(priv->hdev, result);
+	complete_all(&priv->status_report_received);
+}
+
+/*
+ * Checks whether status reports not requested by the driver (e.g. by liquidctl through hidraw)
+ * have been arriving recently enough that the next one can be expected soon.
+ */
+static bool waterforce_external_reports_live(struct waterforce_data *priv)
+{
+	unsigned int window = READ_ONCE(priv->update_interval) + READ_ONCE(priv->request_timeout);
+
+	lockdep_assert_held(&priv->status_report_request_lock);
+
+	return priv->external_report_seen &&
+	       !time_after(jiffies, priv->last_external_report + msecs_to_jiffies(window));
+}
+
+/*
+ * Waits on the pending status request until the deadline, like
+ * wait_for_completion_interruptible_timeout(). If this caller sent it, the timeout window is
+ * split evenly and the command sent again at the end of each part without a reply, as
+ * commands from hidraw users can be interleaved with it and the device may not answer all.
+ * Only status replies complete the request, whichever command they answer.
+ */
+static long waterforce_wait_status(struct waterforce_data *priv, unsigned long deadline,
+				   bool sender)
+{
+	unsigned int resends = sender ? READ_ONCE(status_resends) : 0;
+	unsigned long now, remaining, slice;
+	bool pending;
+	long ret;
+
+	slice = max(msecs_to_jiffies(READ_ONCE(priv->request_timeout)) / (resends + 1), 1UL);
+
+	for (;;) {
+		now = jiffies;
+		remaining = time_before(now, deadline) ? deadline - now : 0;
+		ret = wait_for_completion_interruptible_timeout(&priv->status_report_received,
+								resends ? min(slice, remaining) :
+									  remaining);
+		if (ret || !resends || slice >= remaining)
+			return ret;
+
+		spin_lock_irq(&priv->status_report_request_lock);
+		pending = priv->status_request_pending && priv->status_request_sent;
+		if (pending)
+			priv->status_request_sent_at = ktime_get();
+		spin_unlock_irq(&priv->status_report_request_lock);
+		if (!pending)
+			return 0;
+
+		/* A failed resend still leaves the earlier one to be answered */
+		if (waterforce_write_expanded(priv, get_status_cmd, GET_STATUS_CMD_LENGTH) >= 0)
+			waterforce_count(priv, WATERFORCE_STAT_RESENDS);
+		resends--;
+	}
+}
+
+/*
+ * Requests a status report from the device, unless the cached one is newer than validity ms,
+ * in which case 1 is returned right away. While backing off from an unresponsive device,
+ * fails with -EAGAIN without sending anything.
+ *
+ * Callers arriving while a request is already in flight don't send their own, but wait on
+ * the pending one and share its result.
+ *
+ * In passive mode, while reports requested by someone else keep arriving, the request is
+ * not sent at first and the next such report is waited on instead. The command is sent only
+ * if that doesn't arrive in time.
+ */
+static int waterforce_get_status(struct waterforce_data *priv, unsigned int validity)
+{
+	unsigned long deadline, now;
+	bool send, retried = false;
+	long ret;
+
+retry:
+	send = false;
+	spin_lock_irq(&priv->status_report_request_lock);
+
+	if (waterforce_status_fresh(priv, validity)) {
 		/* Data is up to date */
-		goto unlock_and_return;
+		spin_unlock_irq(&priv->status_report_request_lock);
+		if (retried)
+			return 0;
+		trace_waterforce_status_cache(priv->hdev, true, validity);
+		return 1;
 	}
 
-	/*
-	 * Disable raw event parsing for a moment to safely reinitialize the
-	 * completion. Reinit is done because hidraw could have triggered
-	 * the raw event parsing and marked the priv->status_report_received
-	 * completion as done.
-	 */
-	spin_lock_bh(&priv->status_report_request_lock);
-	reinit_completion(&priv->status_report_received);
-	spin_unlock_bh(&priv->status_report_request_lock);
+	now = jiffies;
+	if (priv->breaker_tripped && !priv->status_request_pending &&
+	    time_before(now, priv->breaker_until)) {
+		/* Backing off from an unresponsive device */
+		spin_unlock_irq(&priv->status_report_request_lock);
+		return -EAGAIN;
+	}
 
-	/* Send command for getting status */
-	ret = waterforce_write_expanded(priv, get_status_cmd, GET_STATUS_CMD_LENGTH);
-	if (ret < 0)
+	if (priv->status_request_pending && !time_before(now, priv->status_request_deadline)) {
+		if (!priv->status_request_sent) {
+			/* Nothing arrived while listening, so request the status after all */
+			priv->status_request_sent = true;
+			priv->status_request_deadline =
+			    now + msecs_to_jiffies(READ_ONCE(priv->request_timeout));
+			priv->status_request_sent_at = ktime_get();
+			send = true;
+		} else {
+			/* The previous request was abandoned by its waiters and never answered */
+			waterforce_finish_status_request(priv, -ETIMEDOUT);
+		}
+	}
+
+	if (!priv->status_request_pending) {
+		/*
+		 * Reinit is done because hidraw could have triggered the raw event
+		 * parsing and marked the priv->status_report_received completion as done.
+		 */
+		reinit_completion(&priv->status_report_received);
+		priv->status_request_pending = true;
+		priv->status_request_sent = !(READ_ONCE(passive) &&
+					      waterforce_external_reports_live(priv));
+		priv->status_request_deadline =
+		    now + msecs_to_jiffies(READ_ONCE(priv->request_timeout));
+		priv->status_request_sent_at = ktime_get();
+		send = priv->status_request_sent;
+	} else if (!send && !retried) {
+		waterforce_count(priv, WATERFORCE_STAT_COALESCED);
+	}
+	deadline = priv->status_request_deadline;
+
+	spin_unlock_irq(&priv->status_report_request_lock);
+
+	if (!retried)
+		trace_waterforce_status_cache(priv->hdev, false, validity);
+
+	if (send) {
+		/* Send command for getting status */
+		ret = waterforce_write_expanded(priv, get_status_cmd, GET_STATUS_CMD_LENGTH);
+		if (ret < 0) {
+			spin_lock_irq(&priv->status_report_request_lock);
+			if (priv->status_request_pending)
+				waterforce_finish_status_request(priv, ret);
+			spin_unlock_irq(&priv->status_report_request_lock);
+			return ret;
+		}
+		waterforce_count(priv, WATERFORCE_STAT_REQUESTS_SENT);
+	}
+
+	ret = waterforce_wait_status(priv, deadline, send);
+	if (ret < 0) {
+		waterforce_count(priv, WATERFORCE_STAT_INTERRUPTED);
 		return ret;
+	}
 
-	ret = wait_for_completion_interruptible_timeout(&priv->status_report_received,
-							msecs_to_jiffies(STATUS_VALIDITY));
-	if (ret == 0)
+	spin_lock_irq(&priv->status_report_request_lock);
+	if (ret > 0) {
+		ret = priv->status_request_result;
+	} else if (waterforce_status_fresh(priv, validity)) {
+		/* Raced with a newer request being answered */
+		ret = 0;
+	} else if (priv->status_request_pending &&
+		   (!priv->status_request_sent ||
+		    time_before(jiffies, priv->status_request_deadline))) {
+		/* Passive wait ran out, or the request got sent after it did */
+		spin_unlock_irq(&priv->status_report_request_lock);
+		retried = true;
+		goto retry;
+	} else {
+		if (priv->status_request_pending)
+			waterforce_finish_status_request(priv, -ETIMEDOUT);
 		ret = -ETIMEDOUT;
+	}
+	spin_unlock_irq(&priv->status_report_request_lock);
+
+	return ret;
+}
 
-unlock_and_return:
-	mutex_unlock(&priv->status_report_request_mutex);
+/* Counts a sysfs read on the local CPU, without touching any shared cacheline */
+static void waterforce_count_read(struct waterforce_data *priv, int ret, bool cached)
+{
+	struct waterforce_read_stats *stats = get_cpu_ptr(priv->read_stats);
+
+	u64_stats_update_begin(&stats->syncp);
 	if (ret < 0)
-		return ret;
+		u64_stats_inc(&stats->errors);
+	else if (cached)
+		u64_stats_inc(&stats->hits);
+	else
+		u64_stats_inc(&stats->misses);
+	u64_stats_update_end(&stats->syncp);
+
+	put_cpu_ptr(priv->read_stats);
+}
 
-	return 0;
+/* Provides the sensor data to be shown to userspace, requesting it first if needed */
+static int waterforce_read_status(struct waterforce_data *priv, struct waterforce_status *status)
+{
+	unsigned int validity = READ_ONCE(priv->update_interval);
+	bool cached = true;
+	int ret;
+
+	/*
+	 * Cache hits are served without taking any lock, as the snapshot can be read locklessly.
+	 * Only readers finding it stale go on to request it, sharing a single request.
+	 */
+	if (!priv->poll_interval && waterforce_status_fresh(priv, validity)) {
+		trace_waterforce_status_cache(priv->hdev, true, validity);
+	} else if (!priv->poll_interval) {
+		ret = waterforce_hw_get(priv);
+		if (ret < 0)
+			goto out;
+
+		ret = waterforce_get_status(priv, validity);
+		waterforce_hw_put(priv);
+		/* The last values are still served if the device stopped responding */
+		if (ret < 0 && !READ_ONCE(priv->breaker_tripped))
+			goto out;
+		/* Held back by the breaker, so nothing was waited on, unlike on a timeout */
+		cached = ret > 0 || ret == -EAGAIN;
+	}
+
+	waterforce_get_snapshot(priv, status);
+
+	/*
+	 * With the poller, serve only what it has gathered, without waiting on the device. The
+	 * data may also have never arrived if the device didn't respond to the request above.
+	 */
+	if (!status->valid ||
+	    (priv->poll_interval && !READ_ONCE(priv->breaker_tripped) &&
+	     time_after(jiffies,
+			status->updated + msecs_to_jiffies(waterforce_status_lifetime(priv)))))
+		ret = -ENODATA;
+	else
+		ret = 0;
+
+out:
+	waterforce_count_read(priv, ret, cached);
+	return ret;
+}
+
+/* Converts duty in 0-100% to the 0-255 PWM range used by hwmon */
+static long waterforce_duty_to_pwm(u8 duty)
+{
+	return DIV_ROUND_CLOSEST(duty * 255, 100);
 }
 
 static int waterforce_read(struct device *dev, enum hwmon_sensor_types type,
 			   u32 attr, int channel, long *val)
 {
 	struct waterforce_data *priv = dev_get_drvdata(dev);
-	int ret = waterforce_get_status(priv);
+	struct waterforce_status status;
+	int ret;
+
+	if (type == hwmon_chip) {
+		switch (attr) {
+		case hwmon_chip_update_interval:
+			*val = READ_ONCE(priv->update_interval);
+			return 0;
+		default:
+			return -EOPNOTSUPP;
+		}
+	}
 
+	/* Set while the values served are the last ones from before the device went quiet */
+	if ((type == hwmon_temp && attr == hwmon_temp_fault) ||
+	    (type == hwmon_fan && attr == hwmon_fan_fault)) {
+		*val = READ_ONCE(priv->breaker_tripped);
+		return 0;
+	}
+
+	ret = waterforce_read_status(priv, &status);
 	if (ret < 0)
 		return ret;
 
 	switch (type) {
 	case hwmon_temp:
-		*val = priv->temp_input[channel];
+		*val = status.temp_input[channel];
 		break;
 	case hwmon_fan:
-		*val = priv->speed_input[channel];
+		*val = status.speed_input[channel];
 		break;
 	case hwmon_pwm:
 		switch (attr) {
 		case hwmon_pwm_input:
-			*val = DIV_ROUND_CLOSEST(priv->duty_input[channel] * 255, 100);
+			*val = waterforce_duty_to_pwm(status.duty_input[channel]);
 			break;
 		default:
 			return -EOPNOTSUPP;
@@ -193,6 +855,31 @@ static int waterforce_read(struct device *dev, enum hwmon_sensor_types type,
 	return 0;
 }
 
+static int waterforce_write(struct device *dev, enum hwmon_sensor_types type, u32 attr,
+			    int channel, long val)
+{
+	struct waterforce_data *priv = dev_get_drvdata(dev);
+
+	switch (type) {
+	case hwmon_chip:
+		switch (attr) {
+		case hwmon_chip_update_interval:
+			if (val < 0)
+				return -EINVAL;
+
+			WRITE_ONCE(priv->update_interval, min_t(long, val, MAX_TIMING_SETTING));
+			break;
+		default:
+			return -EOPNOTSUPP;
+		}
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
 static int waterforce_read_string(struct device *dev, enum hwmon_sensor_types type,
 				  u32 attr, int channel, const char **str)
 {
@@ -215,102 +902,894 @@ static int waterforce_get_fw_ver(struct hid_device *hdev)
 	struct waterforce_data *priv = hid_get_drvdata(hdev);
 	int ret;
 
+	priv->fw_request_sent_at = ktime_get();
 	ret = waterforce_write_expanded(priv, get_firmware_ver_cmd, GET_FIRMWARE_VER_CMD_LENGTH);
 	if (ret < 0)
 		return ret;
+	waterforce_count(priv, WATERFORCE_STAT_REQUESTS_SENT);
 
 	ret = wait_for_completion_interruptible_timeout(&priv->fw_version_processed,
-							msecs_to_jiffies(STATUS_VALIDITY));
-	if (ret == 0)
+							msecs_to_jiffies(READ_ONCE(priv->request_timeout)));
+	if (ret == 0) {
+		waterforce_count(priv, WATERFORCE_STAT_TIMEOUTS);
 		return -ETIMEDOUT;
-	else if (ret < 0)
+	} else if (ret < 0) {
+		waterforce_count(priv, WATERFORCE_STAT_INTERRUPTED);
 		return ret;
+	}
 
 	return 0;
 }
 
+static void waterforce_fw_work(struct work_struct *work)
+{
+	struct waterforce_data *priv = container_of(work, struct waterforce_data, fw_work);
+	int ret;
+
+	ret = waterforce_hw_get(priv);
+	if (!ret) {
+		ret = waterforce_get_fw_ver(priv->hdev);
+		waterforce_hw_put(priv);
+	}
+	if (ret < 0)
+		hid_warn(priv->hdev, "fw version request failed with %d\n", ret);
+}
+
 static const struct hwmon_ops waterforce_hwmon_ops = {
 	.is_visible = waterforce_is_visible,
 	.read = waterforce_read,
+	.write = waterforce_write,
 	.read_string = waterforce_read_string
 };
 
 static const struct hwmon_channel_info *waterforce_info[] = {
+	HWMON_CHANNEL_INFO(chip,
+			   HWMON_C_UPDATE_INTERVAL),
 	HWMON_CHANNEL_INFO(temp,
-			   HWMON_T_INPUT | HWMON_T_LABEL),
+			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_FAULT,
+			   HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_FAULT),
 	HWMON_CHANNEL_INFO(fan,
-			   HWMON_F_INPUT | HWMON_F_LABEL,
-			   HWMON_F_INPUT | HWMON_F_LABEL),
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_FAULT,
+			   HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_FAULT),
 	HWMON_CHANNEL_INFO(pwm,
 			   HWMON_PWM_INPUT,
 			   HWMON_PWM_INPUT),
 	NULL
 };
 
+static ssize_t request_timeout_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct waterforce_data *priv = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(priv->request_timeout));
+}
+
+static ssize_t request_timeout_store(struct device *dev, struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct waterforce_data *priv = dev_get_drvdata(dev);
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+
+	if (!val || val > MAX_TIMING_SETTING)
+		return -EINVAL;
+
+	WRITE_ONCE(priv->request_timeout, val);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(request_timeout);
+
+static ssize_t poll_interval_min_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	struct waterforce_data *priv = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(priv->poll_interval_min));
+}
+
+static ssize_t poll_interval_min_store(struct device *dev, struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct waterforce_data *priv = dev_get_drvdata(dev);
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+
+	if (!val || val > READ_ONCE(priv->poll_interval_max))
+		return -EINVAL;
+
+	WRITE_ONCE(priv->poll_interval_min, val);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(poll_interval_min);
+
+static ssize_t poll_interval_max_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	struct waterforce_data *priv = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(priv->poll_interval_max));
+}
+
+static ssize_t poll_interval_max_store(struct device *dev, struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct waterforce_data *priv = dev_get_drvdata(dev);
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val < READ_ONCE(priv->poll_interval_min) || val > MAX_TIMING_SETTING)
+		return -EINVAL;
+
+	WRITE_ONCE(priv->poll_interval_max, val);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(poll_interval_max);
+
+static struct attribute *waterforce_attrs[] = {
+	&dev_attr_request_timeout.attr,
+	&dev_attr_poll_interval_min.attr,
+	&dev_attr_poll_interval_max.attr,
+	NULL
+};
+
+static umode_t waterforce_attr_is_visible(struct kobject *kobj, struct attribute *attr,
+					  int index)
+{
+	struct waterforce_data *priv = dev_get_drvdata(kobj_to_dev(kobj));
+
+	/* The poll interval bounds only matter if the poller is enabled */
+	if ((attr == &dev_attr_poll_interval_min.attr ||
+	     attr == &dev_attr_poll_interval_max.attr) && !priv->poll_interval)
+		return 0;
+
+	return attr->mode;
+}
+
+static const struct attribute_group waterforce_group = {
+	.attrs = waterforce_attrs,
+	.is_visible = waterforce_attr_is_visible,
+};
+
+static const struct attribute_group *waterforce_groups[] = {
+	&waterforce_group,
+	NULL
+};
+
 static const struct hwmon_chip_info waterforce_chip_info = {
 	.ops = &waterforce_hwmon_ops,
 	.info = waterforce_info,
 };
 
+static void waterforce_schedule_notify(struct waterforce_data *priv)
+{
+	unsigned long next_notify = READ_ONCE(priv->next_notify), now = jiffies;
+
+	if (!READ_ONCE(notify_interval))
+		return;
+
+	/* Does nothing if already scheduled, so bursts of reports get coalesced */
+	schedule_delayed_work(&priv->notify_work,
+			      time_before(now, next_notify) ? next_notify - now : 0);
+}
+
+static void waterforce_notify_work(struct work_struct *work)
+{
+	struct waterforce_data *priv = container_of(to_delayed_work(work), struct waterforce_data,
+						    notify_work);
+	struct waterforce_status status;
+	int i;
+
+	WRITE_ONCE(priv->next_notify, jiffies + msecs_to_jiffies(READ_ONCE(notify_interval)));
+
+	waterforce_get_snapshot(priv, &status);
+
+	for (i = 0; i < ARRAY_SIZE(status.temp_input); i++)
+		if (status.temp_input[i] != priv->notified.temp_input[i])
+			hwmon_notify_event(priv->hwmon_dev, hwmon_temp, hwmon_temp_input, i);
+
+	for (i = 0; i < ARRAY_SIZE(status.speed_input); i++)
+		if (status.speed_input[i] != priv->notified.speed_input[i])
+			hwmon_notify_event(priv->hwmon_dev, hwmon_fan, hwmon_fan_input, i);
+
+	for (i = 0; i < ARRAY_SIZE(status.duty_input); i++)
+		if (status.duty_input[i] != priv->notified.duty_input[i])
+			hwmon_notify_event(priv->hwmon_dev, hwmon_pwm, hwmon_pwm_input, i);
+
+	priv->notified = status;
+}
+
+static void waterforce_parse_fw_ver(struct waterforce_data *priv, const u8 *data, int size)
+{
+	WRITE_ONCE(priv->firmware_version,
+		   data[FIRMWARE_VER_START_OFFSET_1] * 10 + data[FIRMWARE_VER_START_OFFSET_2]);
+
+	if (!completion_done(&priv->fw_version_processed)) {
+		waterforce_record_rtt(priv, priv->fw_request_sent_at);
+		complete_all(&priv->fw_version_processed);
+	}
+}
+
+/*
+ * Runs the coolant temp, reported only in whole degrees, through an exponential moving average
+ * filter and derives its rate of change. Called with status_lock held, before the timestamp of
+ * the previous report gets overwritten.
+ */
+static void waterforce_filter_temp(struct waterforce_data *priv, s32 temp, u64 timestamp)
+{
+	struct waterforce_status *status = &priv->status;
+	s32 sample = temp << TEMP_FILTER_FRAC_BITS;
+	s32 previous = status->temp_input[1];
+	s64 elapsed;
+
+	if (!status->valid || !temp_filter_shift)
+		priv->temp_filter = sample;
+	else
+		priv->temp_filter += (sample - priv->temp_filter) >>
+				     min_t(unsigned int, temp_filter_shift, TEMP_FILTER_SHIFT_MAX);
+
+	status->temp_input[1] = priv->temp_filter >> TEMP_FILTER_FRAC_BITS;
+
+	elapsed = timestamp - status->timestamp;
+	if (!status->valid)
+		status->temp_rate = 0;
+	else if (elapsed > 0)
+		status->temp_rate = div64_s64((s64)(status->temp_input[1] - previous) * NSEC_PER_SEC,
+					      elapsed);
+}
+
+/* Checks whether readings moved past their deadbands since the given sample */
+static bool waterforce_status_changed(const struct waterforce_status *last, s32 temp,
+				      u16 fan_speed, u16 pump_speed, u8 fan_duty, u8 pump_duty)
+{
+	return abs(temp - last->temp_input[0]) > READ_ONCE(temp_deadband) ||
+	       abs(fan_speed - last->speed_input[0]) > READ_ONCE(fan_deadband) ||
+	       abs(pump_speed - last->speed_input[1]) > READ_ONCE(pump_deadband) ||
+	       abs(fan_duty - last->duty_input[0]) > READ_ONCE(duty_deadband) ||
+	       abs(pump_duty - last->duty_input[1]) > READ_ONCE(duty_deadband);
+}
+
+static void waterforce_parse_status(struct waterforce_data *priv, const u8 *data, int size)
+{
+	u16 fan_speed = get_unaligned_le16(data + WATERFORCE_FAN_SPEED);
+	u16 pump_speed = get_unaligned_le16(data + WATERFORCE_PUMP_SPEED);
+	s32 temp = data[WATERFORCE_TEMP_SENSOR] * 1000;
+	struct waterforce_status *status = &priv->status;
+	u64 timestamp = ktime_get_ns();
+	unsigned long flags;
+	bool changed;
+
+	write_seqlock_irqsave(&priv->status_lock, flags);
+
+	/*
+	 * Compare against the values as of the last change rather than the previous report, so
+	 * that slow drifts within the deadbands still get through eventually
+	 */
+	changed = !status->valid ||
+		  waterforce_status_changed(&priv->history[(priv->history_head - 1) % HISTORY_LENGTH],
+					    temp, fan_speed, pump_speed, data[WATERFORCE_FAN_DUTY],
+					    data[WATERFORCE_PUMP_DUTY]);
+
+	/* Let an adaptive poller know there's something going on */
+	if (status->valid &&
+	    (abs(temp - status->temp_input[0]) >= READ_ONCE(adaptive_temp_delta) ||
+	     abs(fan_speed - status->speed_input[0]) >= READ_ONCE(adaptive_rpm_delta) ||
+	     abs(pump_speed - status->speed_input[1]) >= READ_ONCE(adaptive_rpm_delta)))
+		WRITE_ONCE(priv->poll_activity, true);
+
+	priv->status.temp_input[0] = temp;
+	waterforce_filter_temp(priv, temp, timestamp);
+	priv->status.speed_input[0] = fan_speed;
+	priv->status.speed_input[1] = pump_speed;
+	priv->status.duty_input[0] = data[WATERFORCE_FAN_DUTY];
+	priv->status.duty_input[1] = data[WATERFORCE_PUMP_DUTY];
+	priv->status_raw_length = min_t(int, size, STATUS_RAW_LENGTH);
+	memcpy(priv->status_raw, data, priv->status_raw_length);
+	WRITE_ONCE(priv->status.updated, jiffies);
+	priv->status.timestamp = timestamp;
+	WRITE_ONCE(priv->status.valid, true);
+	priv->status.seq++;
+
+	/* Reports repeating the same values only refresh the cache */
+	if (changed) {
+		priv->status.generation++;
+		priv->history[priv->history_head % HISTORY_LENGTH] = priv->status;
+		WRITE_ONCE(priv->history_head, priv->history_head + 1);
+	}
+
+	write_sequnlock_irqrestore(&priv->status_lock, flags);
+
+	if (changed)
+		wake_up_interruptible(&priv->history_wait);
+	wake_up_interruptible(&priv->sample_wait);
+
+	spin_lock_irqsave(&priv->status_report_request_lock, flags);
+	if (!priv->status_request_pending || !priv->status_request_sent) {
+		/* Not requested by the driver */
+		priv->external_report_seen = true;
+		priv->last_external_report = jiffies;
+	} else {
+		waterforce_record_rtt(priv, priv->status_request_sent_at);
+	}
+	waterforce_breaker_reset(priv);
+	if (priv->status_request_pending)
+		waterforce_finish_status_request(priv, 0);
+	if (changed && priv->notify_enabled)
+		waterforce_schedule_notify(priv);
+	spin_unlock_irqrestore(&priv->status_report_request_lock, flags);
+}
+
+struct waterforce_report_handler {
+	void (*parse)(struct waterforce_data *priv, const u8 *data, int size);
+	u8 min_size;	/* Reports shorter than this are dropped */
+};
+
+/* Replies start with the command they answer, so they're looked up by its second byte */
+static const struct waterforce_report_handler waterforce_report_handlers[U8_MAX + 1] = {
+	[GET_FIRMWARE_VER_OPCODE] = {
+		.parse = waterforce_parse_fw_ver,
+		.min_size = FIRMWARE_VER_START_OFFSET_2 + 1,
+	},
+	[GET_STATUS_OPCODE] = {
+		.parse = waterforce_parse_status,
+		.min_size = WATERFORCE_TEMP_SENSOR + 1,
+	},
+};
+
 static int waterforce_raw_event(struct hid_device *hdev, struct hid_report *report, u8 *data,
 				int size)
 {
 	struct waterforce_data *priv = hid_get_drvdata(hdev);
+	const struct waterforce_report_handler *handler;
 
-	if (data[0] == get_firmware_ver_cmd[0] && data[1] == get_firmware_ver_cmd[1]) {
-		/* Received a firmware version report */
-		priv->firmware_version =
-		    data[FIRMWARE_VER_START_OFFSET_1] * 10 + data[FIRMWARE_VER_START_OFFSET_2];
+	if (size < WATERFORCE_OPCODE_OFFSET + 1 || data[0] != WATERFORCE_CMD_PREFIX)
+		return 0;
+
+	trace_waterforce_report(hdev, data[WATERFORCE_OPCODE_OFFSET], size);
 
-		if (!completion_done(&priv->fw_version_processed))
-			complete_all(&priv->fw_version_processed);
+	handler = &waterforce_report_handlers[data[WATERFORCE_OPCODE_OFFSET]];
+	if (!handler->parse || size < handler->min_size)
 		return 0;
-	}
 
-	if (data[0] != get_status_cmd[0] || data[1] != get_status_cmd[1])
+	/* As if the report never arrived, so that requests waiting on it time out */
+	if (waterforce_fail_reply(priv, size))
 		return 0;
 
-	priv->temp_input[0] = data[WATERFORCE_TEMP_SENSOR] * 1000;
-	priv->speed_input[0] = get_unaligned_le16(data + WATERFORCE_FAN_SPEED);
-	priv->speed_input[1] = get_unaligned_le16(data + WATERFORCE_PUMP_SPEED);
-	priv->duty_input[0] = data[WATERFORCE_FAN_DUTY];
-	priv->duty_input[1] = data[WATERFORCE_PUMP_DUTY];
+	handler->parse(priv, data, size);
 
-	if (!completion_done(&priv->status_report_received))
-		complete_all(&priv->status_report_received);
+	return 0;
+}
+
+/* Arms waterforce_poll_work for the earliest poll that isn't already under way */
+static void waterforce_poll_schedule(void)
+{
+	struct waterforce_data *priv;
+	unsigned long next = 0, now = jiffies;
+	bool found = false;
 
-	priv->updated = jiffies;
+	lockdep_assert_held(&waterforce_pollers_lock);
 
-	return 0;
+	list_for_each_entry(priv, &waterforce_pollers, poll_node) {
+		if (priv->poll_busy)
+			continue;
+
+		if (!found || time_before(priv->next_poll, next))
+			next = priv->next_poll;
+		found = true;
+	}
+
+	if (found)
+		mod_delayed_work(system_wq, &waterforce_poll_work,
+				 time_after(next, now) ? next - now : 0);
+}
+
+/*
+ * Dispatches the polls of all devices that are due, as well as those that would come due
+ * within a quarter of their interval, which then line up with the rest from there on.
+ */
+static void waterforce_poll_work_fn(struct work_struct *work)
+{
+	struct waterforce_data *priv;
+	unsigned long now = jiffies;
+
+	mutex_lock(&waterforce_pollers_lock);
+
+	list_for_each_entry(priv, &waterforce_pollers, poll_node) {
+		unsigned long window = msecs_to_jiffies(READ_ONCE(priv->poll_interval)) / 4;
+
+		if (priv->poll_busy || time_before(now + window, priv->next_poll))
+			continue;
+
+		priv->poll_busy = true;
+		priv->poll_started = now;
+		schedule_work(&priv->status_work);
+	}
+
+	waterforce_poll_schedule();
+	mutex_unlock(&waterforce_pollers_lock);
+}
+
+static void waterforce_status_work(struct work_struct *work)
+{
+	struct waterforce_data *priv = container_of(work, struct waterforce_data, status_work);
+	unsigned int interval = READ_ONCE(priv->poll_interval);
+	int ret;
+
+	/* Skip polling if reports requested by hidraw users already keep the data fresh */
+	ret = waterforce_hw_get(priv);
+	if (!ret) {
+		ret = waterforce_get_status(priv, interval / 2);
+		waterforce_hw_put(priv);
+	}
+	if (ret < 0)
+		hid_dbg(priv->hdev, "background status request failed with %d\n", ret);
+
+	/*
+	 * Poll at the lower bound while readings keep moving, otherwise back off exponentially
+	 * up to the upper one. If they're equal, the interval stays fixed.
+	 */
+	if (xchg(&priv->poll_activity, false))
+		interval = READ_ONCE(priv->poll_interval_min);
+	else
+		interval = min(interval * 2, READ_ONCE(priv->poll_interval_max));
+	interval = clamp(interval, READ_ONCE(priv->poll_interval_min),
+			 READ_ONCE(priv->poll_interval_max));
+	WRITE_ONCE(priv->poll_interval, interval);
+
+	/* Counted from dispatch rather than completion, to stay aligned with the other devices */
+	mutex_lock(&waterforce_pollers_lock);
+	priv->next_poll = priv->poll_started + msecs_to_jiffies(interval);
+	priv->poll_busy = false;
+	waterforce_poll_schedule();
+	mutex_unlock(&waterforce_pollers_lock);
 }
 
 static int firmware_version_show(struct seq_file *seqf, void *unused)
 {
 	struct waterforce_data *priv = seqf->private;
+	int firmware_version = READ_ONCE(priv->firmware_version);
 
-	seq_printf(seqf, "%u\n", priv->firmware_version);
+	/* The reply may still be pending, or may have never arrived */
+	if (!firmware_version)
+		return -ENODATA;
+
+	seq_printf(seqf, "%u\n", firmware_version);
 
 	return 0;
 }
 DEFINE_SHOW_ATTRIBUTE(firmware_version);
 
+/* Formats all sensor values from a single status report as one line */
+static int waterforce_format_status(char *buf, size_t size, const struct waterforce_status *status)
+{
+	int len;
+
+	len = scnprintf(buf, size, "seq=%llu generation=%llu timestamp_ns=%llu temp1_input=%d ",
+			status->seq, status->generation, status->timestamp, status->temp_input[0]);
+	if (temp_filter_shift)
+		len += scnprintf(buf + len, size - len, "temp2_input=%d ", status->temp_input[1]);
+	len += scnprintf(buf + len, size - len,
+			 "temp1_rate=%d fan1_input=%u fan2_input=%u pwm1=%ld pwm2=%ld\n",
+			 status->temp_rate, status->speed_input[0], status->speed_input[1],
+			 waterforce_duty_to_pwm(status->duty_input[0]),
+			 waterforce_duty_to_pwm(status->duty_input[1]));
+
+	return len;
+}
+
+static int status_show(struct seq_file *seqf, void *unused)
+{
+	struct waterforce_data *priv = seqf->private;
+	struct waterforce_status status;
+	char line[STATUS_LINE_LENGTH];
+	int ret;
+
+	ret = waterforce_read_status(priv, &status);
+	if (ret < 0)
+		return ret;
+
+	waterforce_format_status(line, sizeof(line), &status);
+	seq_puts(seqf, line);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(status);
+
+/* Dumps the latest status report, as received, in hex */
+static int status_raw_show(struct seq_file *seqf, void *unused)
+{
+	struct waterforce_data *priv = seqf->private;
+	struct waterforce_status status;
+	u8 raw[STATUS_RAW_LENGTH];
+	unsigned int seq;
+	int ret, length;
+
+	ret = waterforce_read_status(priv, &status);
+	if (ret < 0)
+		return ret;
+
+	do {
+		seq = read_seqbegin(&priv->status_lock);
+		length = priv->status_raw_length;
+		memcpy(raw, priv->status_raw, length);
+	} while (read_seqretry(&priv->status_lock, seq));
+
+	seq_printf(seqf, "%*ph\n", length, raw);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(status_raw);
+
+static int stats_show(struct seq_file *seqf, void *unused)
+{
+	struct waterforce_data *priv = seqf->private;
+	struct waterforce_stats stats;
+	u64 hits = 0, misses = 0, errors = 0, seen = 0;
+	int cpu, i;
+
+	spin_lock_irq(&priv->stats_lock);
+	stats = priv->stats;
+	spin_unlock_irq(&priv->stats_lock);
+
+	for (i = 0; i < WATERFORCE_STAT_COUNT; i++)
+		seq_printf(seqf, "%s: %llu\n", waterforce_stat_names[i], stats.count[i]);
+
+	for_each_possible_cpu(cpu) {
+		const struct waterforce_read_stats *cpu_stats = per_cpu_ptr(priv->read_stats, cpu);
+		u64 cpu_hits, cpu_misses, cpu_errors;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin(&cpu_stats->syncp);
+			cpu_hits = u64_stats_read(&cpu_stats->hits);
+			cpu_misses = u64_stats_read(&cpu_stats->misses);
+			cpu_errors = u64_stats_read(&cpu_stats->errors);
+		} while (u64_stats_fetch_retry(&cpu_stats->syncp, start));
+
+		hits += cpu_hits;
+		misses += cpu_misses;
+		errors += cpu_errors;
+	}
+
+	seq_printf(seqf, "read_hits: %llu\n", hits);
+	seq_printf(seqf, "read_misses: %llu\n", misses);
+	seq_printf(seqf, "read_errors: %llu\n", errors);
+
+	seq_printf(seqf, "power_up_max_us: %llu\n", div_u64(stats.power_up_max, NSEC_PER_USEC));
+
+	seq_printf(seqf, "replies: %llu\n", stats.rtt_count);
+	if (!stats.rtt_count)
+		return 0;
+
+	/* Histogram bucket holding the 99th percentile, the last one if none before it does */
+	for (i = 0; i < RTT_HISTOGRAM_BUCKETS - 1; i++) {
+		seen += stats.rtt_histogram[i];
+		if (seen * 100 >= stats.rtt_count * 99)
+			break;
+	}
+
+	seq_printf(seqf, "rtt_min_us: %llu\n", div_u64(stats.rtt_min, NSEC_PER_USEC));
+	seq_printf(seqf, "rtt_avg_us: %llu\n",
+		   div64_u64(stats.rtt_sum, stats.rtt_count * NSEC_PER_USEC));
+	seq_printf(seqf, "rtt_max_us: %llu\n", div_u64(stats.rtt_max, NSEC_PER_USEC));
+	/* The last bucket also holds all longer round trips, so it has no upper bound */
+	if (i == RTT_HISTOGRAM_BUCKETS - 1)
+		seq_printf(seqf, "rtt_p99_us: >=%llu\n", 1ULL << i);
+	else
+		seq_printf(seqf, "rtt_p99_us: <%llu\n", 2ULL << i);
+
+	for (i = 0; i < RTT_HISTOGRAM_BUCKETS - 1; i++)
+		if (stats.rtt_histogram[i])
+			seq_printf(seqf, "rtt_us[%llu-%llu): %llu\n", i ? 1ULL << i : 0,
+				   2ULL << i, stats.rtt_histogram[i]);
+	if (stats.rtt_histogram[i])
+		seq_printf(seqf, "rtt_us[%llu-): %llu\n", 1ULL << i, stats.rtt_histogram[i]);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats);
+
+struct waterforce_history_reader {
+	struct waterforce_data *priv;
+	u64 pos;	/* Index of the next report to be read */
+};
+
+static int history_open(struct inode *inode, struct file *file)
+{
+	struct waterforce_data *priv = inode->i_private;
+	struct waterforce_history_reader *reader;
+	u64 head;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (!reader)
+		return -ENOMEM;
+
+	/* Start with the oldest report still in the ring */
+	head = READ_ONCE(priv->history_head);
+	reader->priv = priv;
+	reader->pos = head > HISTORY_LENGTH ? head - HISTORY_LENGTH : 0;
+	file->private_data = reader;
+
+	return nonseekable_open(inode, file);
+}
+
+static bool waterforce_history_available(struct waterforce_history_reader *reader)
+{
+	return READ_ONCE(reader->priv->removed) ||
+	       reader->pos != READ_ONCE(reader->priv->history_head);
+}
+
+/*
+ * Streams the stored reports as lines of text, blocking until new ones arrive unless opened
+ * with O_NONBLOCK. Reports that were overwritten before being read are skipped.
+ */
+static ssize_t history_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct waterforce_history_reader *reader = file->private_data;
+	struct waterforce_data *priv = reader->priv;
+	struct waterforce_status sample;
+	char line[HISTORY_LINE_LENGTH];
+	unsigned long flags;
+	size_t copied = 0;
+	int len, ret;
+
+	if (count < sizeof(line))
+		return -EINVAL;
+
+	while (count - copied >= sizeof(line)) {
+		if (!waterforce_history_available(reader)) {
+			if (copied)
+				break;
+
+			if (file->f_flags & O_NONBLOCK)
+				return -EAGAIN;
+
+			ret = wait_event_interruptible(priv->history_wait,
+						       waterforce_history_available(reader));
+			if (ret < 0)
+				return ret;
+		}
+
+		if (READ_ONCE(priv->removed))
+			return copied ? copied : -ENODEV;
+
+		read_seqlock_excl_irqsave(&priv->status_lock, flags);
+		if (priv->history_head - reader->pos > HISTORY_LENGTH)
+			reader->pos = priv->history_head - HISTORY_LENGTH;
+		sample = priv->history[reader->pos % HISTORY_LENGTH];
+		reader->pos++;
+		read_sequnlock_excl_irqrestore(&priv->status_lock, flags);
+
+		len = scnprintf(line, sizeof(line), "%llu %d %u %u %ld %ld\n", sample.timestamp,
+				sample.temp_input[0], sample.speed_input[0], sample.speed_input[1],
+				waterforce_duty_to_pwm(sample.duty_input[0]),
+				waterforce_duty_to_pwm(sample.duty_input[1]));
+
+		if (copy_to_user(buf + copied, line, len))
+			return -EFAULT;
+		copied += len;
+	}
+
+	return copied;
+}
+
+static __poll_t history_poll(struct file *file, poll_table *wait)
+{
+	struct waterforce_history_reader *reader = file->private_data;
+
+	poll_wait(file, &reader->priv->history_wait, wait);
+
+	return waterforce_history_available(reader) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static int history_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+
+	return 0;
+}
+
+static const struct file_operations history_fops = {
+	.owner = THIS_MODULE,
+	.open = history_open,
+	.read = history_read,
+	.poll = history_poll,
+	.release = history_release,
+};
+
+struct waterforce_sample_reader {
+	struct waterforce_data *priv;
+	u64 seq;	/* Reads return the first report past this one */
+};
+
+static int next_status_open(struct inode *inode, struct file *file)
+{
+	struct waterforce_data *priv = inode->i_private;
+	struct waterforce_sample_reader *reader;
+	struct waterforce_status status;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (!reader)
+		return -ENOMEM;
+
+	/* Wait for the report after the current one, unless told otherwise */
+	waterforce_get_snapshot(priv, &status);
+	reader->priv = priv;
+	reader->seq = status.seq;
+	file->private_data = reader;
+
+	return nonseekable_open(inode, file);
+}
+
+static bool waterforce_sample_available(struct waterforce_sample_reader *reader,
+					struct waterforce_status *status)
+{
+	waterforce_get_snapshot(reader->priv, status);
+
+	return READ_ONCE(reader->priv->removed) || (status->valid && status->seq > reader->seq);
+}
+
+/*
+ * Returns the first status report with a sequence number past the one last read or written,
+ * blocking until it arrives unless opened with O_NONBLOCK. Without the poller, the report is
+ * requested as usual, so readers waiting at the same time share a single request. While
+ * backing off from an unresponsive device, the back off is waited out instead of failing.
+ */
+static ssize_t next_status_read(struct file *file, char __user *buf, size_t count,
+				loff_t *ppos)
+{
+	struct waterforce_sample_reader *reader = file->private_data;
+	struct waterforce_data *priv = reader->priv;
+	struct waterforce_status status;
+	char line[STATUS_LINE_LENGTH];
+	long remaining;
+	int len, ret;
+
+	if (count < sizeof(line))
+		return -EINVAL;
+
+	while (!waterforce_sample_available(reader, &status)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		if (priv->poll_interval) {
+			ret = wait_event_interruptible(priv->sample_wait,
+						       waterforce_sample_available(reader, &status));
+			if (ret < 0)
+				return ret;
+			break;
+		}
+
+		ret = waterforce_hw_get(priv);
+		if (ret < 0)
+			return ret;
+
+		ret = waterforce_get_status(priv, 0);
+		waterforce_hw_put(priv);
+		if (ret == -EAGAIN) {
+			/* Backing off from an unresponsive device, so wait that out or for a report */
+			remaining = max_t(long, READ_ONCE(priv->breaker_until) - jiffies, 1);
+			ret = wait_event_interruptible_timeout(priv->sample_wait,
+					waterforce_sample_available(reader, &status), remaining);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
+		if (ret < 0)
+			return ret;
+
+		/* A report arrived within this jiffy, so give the next one a moment */
+		if (ret > 0)
+			schedule_timeout_interruptible(1);
+	}
+
+	if (READ_ONCE(priv->removed))
+		return -ENODEV;
+
+	reader->seq = status.seq;
+	len = waterforce_format_status(line, sizeof(line), &status);
+	if (copy_to_user(buf, line, len))
+		return -EFAULT;
+
+	return len;
+}
+
+/* Sets the sequence number that the next read has to go past */
+static ssize_t next_status_write(struct file *file, const char __user *buf, size_t count,
+				 loff_t *ppos)
+{
+	struct waterforce_sample_reader *reader = file->private_data;
+	u64 seq;
+	int ret;
+
+	ret = kstrtou64_from_user(buf, count, 10, &seq);
+	if (ret < 0)
+		return ret;
+
+	reader->seq = seq;
+
+	return count;
+}
+
+static __poll_t next_status_poll(struct file *file, poll_table *wait)
+{
+	struct waterforce_sample_reader *reader = file->private_data;
+	struct waterforce_status status;
+
+	poll_wait(file, &reader->priv->sample_wait, wait);
+
+	return waterforce_sample_available(reader, &status) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static int next_status_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+
+	return 0;
+}
+
+static const struct file_operations next_status_fops = {
+	.owner = THIS_MODULE,
+	.open = next_status_open,
+	.read = next_status_read,
+	.write = next_status_write,
+	.poll = next_status_poll,
+	.release = next_status_release,
+};
+
 static void waterforce_debugfs_init(struct waterforce_data *priv)
 {
 	char name[64];
 
-	if (!priv->firmware_version)
-		return;	/* There's nothing to show in debugfs */
-
 	scnprintf(name, sizeof(name), "%s-%s", DRIVER_NAME, dev_name(&priv->hdev->dev));
 
 	priv->debugfs = debugfs_create_dir(name, NULL);
 	debugfs_create_file("firmware_version", 0444, priv->debugfs, priv, &firmware_version_fops);
+	debugfs_create_file("status", 0444, priv->debugfs, priv, &status_fops);
+	debugfs_create_file("status_raw", 0444, priv->debugfs, priv, &status_raw_fops);
+	debugfs_create_file("history", 0444, priv->debugfs, priv, &history_fops);
+	debugfs_create_file("next_status", 0644, priv->debugfs, priv, &next_status_fops);
+	debugfs_create_file("stats", 0444, priv->debugfs, priv, &stats_fops);
+	waterforce_fault_debugfs_init(priv);
+}
+
+/* Returns the length of the largest output report declared in the HID descriptor */
+static size_t waterforce_output_report_length(struct hid_device *hdev)
+{
+	struct hid_report_enum *output_enum = &hdev->report_enum[HID_OUTPUT_REPORT];
+	struct hid_report *report;
+	size_t length = 0;
+
+	list_for_each_entry(report, &output_enum->report_list, list)
+		length = max_t(size_t, length, hid_report_len(report));
+
+	if (!length || length > MAX_REPORT_LENGTH)
+		return MAX_REPORT_LENGTH;
+
+	return length;
 }
 
 static int waterforce_probe(struct hid_device *hdev, const struct hid_device_id *id)
 {
 	struct waterforce_data *priv;
-	int ret;
+	int cpu, ret;
 
 	priv = devm_kzalloc(&hdev->dev, sizeof(*priv), GFP_KERNEL);
 	if (!priv)
@@ -319,12 +1798,12 @@ static int waterforce_probe(struct hid_device *hdev, const struct hid_device_id
 	priv->hdev = hdev;
 	hid_set_drvdata(hdev, priv);
 
-	/*
-	 * Initialize priv->updated to STATUS_VALIDITY seconds in the past, making
-	 * the initial empty data invalid for waterforce_read() without the need for
-	 * a special case there.
-	 */
-	priv->updated = jiffies - msecs_to_jiffies(STATUS_VALIDITY);
+	priv->poll_interval = poll_interval;
+	priv->poll_interval_min = poll_interval;
+	priv->poll_interval_max = poll_interval;
+	priv->update_interval = STATUS_VALIDITY;
+	priv->request_timeout = REQUEST_TIMEOUT;
+	seqlock_init(&priv->status_lock);
 
 	ret = hid_parse(hdev);
 	if (ret) {
@@ -347,25 +1826,50 @@ static int waterforce_probe(struct hid_device *hdev, const struct hid_device_id
 		goto fail_and_stop;
 	}
 
-	priv->buffer = devm_kzalloc(&hdev->dev, MAX_REPORT_LENGTH, GFP_KERNEL);
+	priv->output_report_length = MAX_REPORT_LENGTH;
+	if (descriptor_report_length)
+		priv->output_report_length = waterforce_output_report_length(hdev);
+
+	/* Allocated apart from priv so that it's DMA-safe, and only as long as what gets sent */
+	priv->buffer = devm_kzalloc(&hdev->dev, priv->output_report_length, GFP_KERNEL);
 	if (!priv->buffer) {
 		ret = -ENOMEM;
 		goto fail_and_close;
 	}
 
-	mutex_init(&priv->status_report_request_mutex);
+	priv->history = devm_kcalloc(&hdev->dev, HISTORY_LENGTH, sizeof(*priv->history),
+				     GFP_KERNEL);
+	if (!priv->history) {
+		ret = -ENOMEM;
+		goto fail_and_close;
+	}
+	init_waitqueue_head(&priv->history_wait);
+	init_waitqueue_head(&priv->sample_wait);
+
 	mutex_init(&priv->buffer_lock);
+
+	priv->read_stats = devm_alloc_percpu(&hdev->dev, struct waterforce_read_stats);
+	if (!priv->read_stats) {
+		ret = -ENOMEM;
+		goto fail_and_close;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(priv->read_stats, cpu)->syncp);
+
 	spin_lock_init(&priv->status_report_request_lock);
+	spin_lock_init(&priv->stats_lock);
+	waterforce_fault_init(priv);
 	init_completion(&priv->status_report_received);
 	init_completion(&priv->fw_version_processed);
+	INIT_WORK(&priv->status_work, waterforce_status_work);
+	INIT_DELAYED_WORK(&priv->notify_work, waterforce_notify_work);
+	INIT_WORK(&priv->fw_work, waterforce_fw_work);
 
 	hid_device_io_start(hdev);
-	ret = waterforce_get_fw_ver(hdev);
-	if (ret < 0)
-		hid_warn(hdev, "fw version request failed with %d\n", ret);
 
 	priv->hwmon_dev = hwmon_device_register_with_info(&hdev->dev, "waterforce",
-							  priv, &waterforce_chip_info, NULL);
+							  priv, &waterforce_chip_info,
+							  waterforce_groups);
 	if (IS_ERR(priv->hwmon_dev)) {
 		ret = PTR_ERR(priv->hwmon_dev);
 		hid_err(hdev, "hwmon registration failed with %d\n", ret);
@@ -374,6 +1878,19 @@ static int waterforce_probe(struct hid_device *hdev, const struct hid_device_id
 
 	waterforce_debugfs_init(priv);
 
+	spin_lock_irq(&priv->status_report_request_lock);
+	priv->notify_enabled = true;
+	spin_unlock_irq(&priv->status_report_request_lock);
+
+	schedule_work(&priv->fw_work);
+	if (priv->poll_interval) {
+		mutex_lock(&waterforce_pollers_lock);
+		priv->next_poll = jiffies;
+		list_add_tail(&priv->poll_node, &waterforce_pollers);
+		waterforce_poll_schedule();
+		mutex_unlock(&waterforce_pollers_lock);
+	}
+
 	return 0;
 
 fail_and_close:
@@ -387,6 +1904,24 @@ static void waterforce_remove(struct hid_device *hdev)
 {
 	struct waterforce_data *priv = hid_get_drvdata(hdev);
 
+	cancel_work_sync(&priv->fw_work);
+	if (priv->poll_interval) {
+		/* Once off the list, the poll can't be dispatched again */
+		mutex_lock(&waterforce_pollers_lock);
+		list_del(&priv->poll_node);
+		mutex_unlock(&waterforce_pollers_lock);
+		cancel_work_sync(&priv->status_work);
+	}
+
+	spin_lock_irq(&priv->status_report_request_lock);
+	priv->notify_enabled = false;
+	spin_unlock_irq(&priv->status_report_request_lock);
+	cancel_delayed_work_sync(&priv->notify_work);
+
+	/* Blocked history readers would otherwise hold up the debugfs removal */
+	WRITE_ONCE(priv->removed, true);
+	wake_up_interruptible_all(&priv->history_wait);
+	wake_up_interruptible_all(&priv->sample_wait);
 	debugfs_remove_recursive(priv->debugfs);
 	hwmon_device_unregister(priv->hwmon_dev);
 
@@ -417,6 +1952,7 @@ static int __init waterforce_init(void)
 static void __exit waterforce_exit(void)
 {
 	hid_unregister_driver(&waterforce_driver);
+	cancel_delayed_work_sync(&waterforce_poll_work);
 }
 
 /* When compiled into the kernel, initialize after the HID bus */
@@ -426,3 +1962,7 @@ module_exit(waterforce_exit);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Aleksa Savic <savicaleksa83@gmail.com>");
 MODULE_DESCRIPTION("Hwmon driver for Gigabyte AORUS Waterforce AIO coolers");
+
+#ifdef WATERFORCE_KUNIT
+#include "gigabyte_waterforce_test.c"
+#endif
@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * KUnit tests and benchmarks for the report parsing and caching paths of gigabyte_waterforce
+ *
+ * Included at the end of gigabyte_waterforce.c when built through "make kunit", so that the
+ * static functions can be called directly. Reports are replayed into waterforce_raw_event()
+ * of a mock hid_device, with no hardware or HID transport involved.
+ */
+
+#include <kunit/test.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+
+#define WATERFORCE_TEST_LOOPS		10000	/* Operations timed per benchmark */
+#define WATERFORCE_TEST_MAX_READERS	8	/* Workers of the contended read benchmark */
+
+/*
+ * Synthetic replies, laid out over the full 64 byte report as the driver decodes it. No capture
+ * from a device is included yet; one can be pasted over these as is, updating the values
+ * expected below. Bytes the driver doesn't decode are filled with 0xA5 rather than left zeroed,
+ * so that the tests also show they are carried along without affecting the readings.
+ */
+static const u8 waterforce_test_status_report[64] = {
+	0x99, 0xDA,		/* Answering GET_STATUS_OPCODE */
+	0xDC, 0x05,		/* Fan speed, 1500 RPM */
+	0xA5,
+	0xF0, 0x0A,		/* Pump speed, 2800 RPM */
+	0xA5,
+	0x32,			/* Fan duty, 50% */
+	0x55,			/* Pump duty, 85% */
+	0xA5, 0xA5, 0xA5,
+	0x1F,			/* Coolant temp, 31 degrees */
+	[14 ... 63] = 0xA5,
+};
+
+static const u8 waterforce_test_fw_ver_report[64] = {
+	0x99, 0xD6,		/* Answering GET_FIRMWARE_VER_OPCODE */
+	0x01, 0x02,		/* Firmware version 1.2 */
+	[4 ... 63] = 0xA5,
+};
+
+/* Hands the report to the driver as the HID core would, from a writable copy */
+static void waterforce_test_replay(struct waterforce_data *priv, const u8 *report, int size)
+{
+	u8 data[64];
+
+	memcpy(data, report, size);
+	waterforce_raw_event(priv->hdev, NULL, data, size);
+}
+
+/* Sets up priv like waterforce_probe() does, minus everything that needs the transport */
+static int waterforce_test_init(struct kunit *test)
+{
+	struct waterforce_data *priv;
+	struct hid_device *hdev;
+	int cpu;
+
+	hdev = kunit_kzalloc(test, sizeof(*hdev), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, hdev);
+
+	priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv);
+
+	priv->hdev = hdev;
+	hid_set_drvdata(hdev, priv);
+
+	/* Keeps the first report fresh for the whole run, so that reads are cache hits */
+	priv->update_interval = MAX_TIMING_SETTING;
+	priv->request_timeout = REQUEST_TIMEOUT;
+	seqlock_init(&priv->status_lock);
+
+	priv->history = kunit_kcalloc(test, HISTORY_LENGTH, sizeof(*priv->history), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv->history);
+	init_waitqueue_head(&priv->history_wait);
+	init_waitqueue_head(&priv->sample_wait);
+
+	priv->read_stats = alloc_percpu(struct waterforce_read_stats);
+	KUNIT_ASSERT_NOT_NULL(test, priv->read_stats);
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(priv->read_stats, cpu)->syncp);
+
+	spin_lock_init(&priv->status_report_request_lock);
+	spin_lock_init(&priv->stats_lock);
+	waterforce_fault_init(priv);
+	init_completion(&priv->status_report_received);
+	init_completion(&priv->fw_version_processed);
+
+	test->priv = priv;
+	return 0;
+}
+
+static void waterforce_test_exit(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+
+	if (priv)
+		free_percpu(priv->read_stats);
+}
+
+static void waterforce_test_parse_status(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+	struct waterforce_status status;
+
+	waterforce_test_replay(priv, waterforce_test_status_report,
+			       sizeof(waterforce_test_status_report));
+	waterforce_get_snapshot(priv, &status);
+
+	KUNIT_ASSERT_TRUE(test, status.valid);
+	KUNIT_EXPECT_EQ(test, status.temp_input[0], 31000);
+	KUNIT_EXPECT_EQ(test, status.speed_input[0], 1500);
+	KUNIT_EXPECT_EQ(test, status.speed_input[1], 2800);
+	KUNIT_EXPECT_EQ(test, status.duty_input[0], 50);
+	KUNIT_EXPECT_EQ(test, status.duty_input[1], 85);
+	KUNIT_EXPECT_EQ(test, status.seq, 1);
+	KUNIT_EXPECT_EQ(test, status.generation, 1);
+
+	KUNIT_EXPECT_EQ(test, priv->history_head, 1);
+	KUNIT_EXPECT_EQ(test, priv->history[0].temp_input[0], 31000);
+	KUNIT_EXPECT_EQ(test, priv->status_raw_length, STATUS_RAW_LENGTH);
+	KUNIT_EXPECT_MEMEQ(test, priv->status_raw, waterforce_test_status_report,
+			   STATUS_RAW_LENGTH);
+}
+
+static void waterforce_test_repeated_status(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+	struct waterforce_status status;
+
+	waterforce_test_replay(priv, waterforce_test_status_report,
+			       sizeof(waterforce_test_status_report));
+	waterforce_test_replay(priv, waterforce_test_status_report,
+			       sizeof(waterforce_test_status_report));
+	waterforce_get_snapshot(priv, &status);
+
+	/* Identical reports only refresh the cache */
+	KUNIT_EXPECT_EQ(test, status.seq, 2);
+	KUNIT_EXPECT_EQ(test, status.generation, 1);
+	KUNIT_EXPECT_EQ(test, priv->history_head, 1);
+}
+
+static void waterforce_test_parse_fw_ver(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+
+	waterforce_test_replay(priv, waterforce_test_fw_ver_report,
+			       sizeof(waterforce_test_fw_ver_report));
+
+	KUNIT_EXPECT_EQ(test, priv->firmware_version, 12);
+	KUNIT_EXPECT_TRUE(test, completion_done(&priv->fw_version_processed));
+}
+
+static void waterforce_test_short_reports(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+	u8 unknown[64] = { WATERFORCE_CMD_PREFIX, 0x00 };
+
+	/* Cut off right before the coolant temp and the firmware version */
+	waterforce_test_replay(priv, waterforce_test_status_report, WATERFORCE_TEMP_SENSOR);
+	waterforce_test_replay(priv, waterforce_test_fw_ver_report, FIRMWARE_VER_START_OFFSET_2);
+	waterforce_test_replay(priv, unknown, sizeof(unknown));
+
+	KUNIT_EXPECT_FALSE(test, priv->status.valid);
+	KUNIT_EXPECT_EQ(test, priv->firmware_version, 0);
+}
+
+static void waterforce_test_completes_request(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+
+	spin_lock_irq(&priv->status_report_request_lock);
+	priv->status_request_pending = true;
+	priv->status_request_sent = true;
+	priv->status_request_sent_at = ktime_get();
+	spin_unlock_irq(&priv->status_report_request_lock);
+
+	waterforce_test_replay(priv, waterforce_test_status_report,
+			       sizeof(waterforce_test_status_report));
+
+	KUNIT_EXPECT_FALSE(test, priv->status_request_pending);
+	KUNIT_EXPECT_EQ(test, priv->status_request_result, 0);
+	KUNIT_EXPECT_TRUE(test, completion_done(&priv->status_report_received));
+	KUNIT_EXPECT_EQ(test, priv->stats.rtt_count, 1);
+	KUNIT_EXPECT_EQ(test, waterforce_get_status(priv, MAX_TIMING_SETTING), 1);
+}
+
+static void waterforce_test_bench_parse(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+	u8 data[sizeof(waterforce_test_status_report)];
+	ktime_t start;
+	u64 elapsed;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < WATERFORCE_TEST_LOOPS; i++) {
+		memcpy(data, waterforce_test_status_report, sizeof(data));
+		/* Alternate the temp, so that every other report counts as changed */
+		data[WATERFORCE_TEMP_SENSOR] += i & 1;
+		waterforce_raw_event(priv->hdev, NULL, data, sizeof(data));
+	}
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	KUNIT_EXPECT_EQ(test, priv->status.seq, WATERFORCE_TEST_LOOPS);
+	kunit_info(test, "parse: %llu ns/op\n", div_u64(elapsed, WATERFORCE_TEST_LOOPS));
+}
+
+static void waterforce_test_bench_cached_read(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+	struct waterforce_status status;
+	int i, errors = 0;
+	ktime_t start;
+	u64 elapsed;
+
+	waterforce_test_replay(priv, waterforce_test_status_report,
+			       sizeof(waterforce_test_status_report));
+
+	start = ktime_get();
+	for (i = 0; i < WATERFORCE_TEST_LOOPS; i++)
+		if (waterforce_read_status(priv, &status) < 0)
+			errors++;
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	KUNIT_EXPECT_EQ(test, errors, 0);
+	KUNIT_EXPECT_EQ(test, status.temp_input[0], 31000);
+	kunit_info(test, "cached read: %llu ns/op\n", div_u64(elapsed, WATERFORCE_TEST_LOOPS));
+}
+
+struct waterforce_test_reader {
+	struct work_struct work;
+	struct waterforce_data *priv;
+	atomic_t *running;
+	u64 elapsed;	/* ns */
+	int errors;
+};
+
+static void waterforce_test_reader_fn(struct work_struct *work)
+{
+	struct waterforce_test_reader *reader = container_of(work, struct waterforce_test_reader,
+							     work);
+	struct waterforce_status status;
+	ktime_t start = ktime_get();
+	int i;
+
+	for (i = 0; i < WATERFORCE_TEST_LOOPS; i++)
+		if (waterforce_read_status(reader->priv, &status) < 0)
+			reader->errors++;
+
+	reader->elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+	atomic_dec(reader->running);
+}
+
+/*
+ * Reads from a worker on each of up to WATERFORCE_TEST_MAX_READERS CPUs, while reports keep
+ * arriving, so that the readers race with the writer of the snapshot and with each other
+ */
+static void waterforce_test_bench_contended_read(struct kunit *test)
+{
+	struct waterforce_data *priv = test->priv;
+	struct waterforce_test_reader *readers;
+	int cpu, i, count = 0, errors = 0;
+	u64 elapsed = 0, reports = 0;
+	atomic_t running;
+
+	readers = kunit_kcalloc(test, WATERFORCE_TEST_MAX_READERS, sizeof(*readers), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, readers);
+
+	waterforce_test_replay(priv, waterforce_test_status_report,
+			       sizeof(waterforce_test_status_report));
+
+	cpus_read_lock();
+	atomic_set(&running, min_t(int, num_online_cpus(), WATERFORCE_TEST_MAX_READERS));
+	for_each_online_cpu(cpu) {
+		if (count == WATERFORCE_TEST_MAX_READERS)
+			break;
+
+		readers[count].priv = priv;
+		readers[count].running = &running;
+		INIT_WORK(&readers[count].work, waterforce_test_reader_fn);
+		schedule_work_on(cpu, &readers[count].work);
+		count++;
+	}
+	cpus_read_unlock();
+
+	while (atomic_read(&running)) {
+		waterforce_test_replay(priv, waterforce_test_status_report,
+				       sizeof(waterforce_test_status_report));
+		reports++;
+		cond_resched();
+	}
+
+	for (i = 0; i < count; i++) {
+		flush_work(&readers[i].work);
+		elapsed += readers[i].elapsed;
+		errors += readers[i].errors;
+	}
+
+	KUNIT_EXPECT_EQ(test, errors, 0);
+	kunit_info(test, "contended read, %d readers and %llu reports: %llu ns/op\n", count,
+		   reports, div_u64(elapsed, count * WATERFORCE_TEST_LOOPS));
+}
+
+static struct kunit_case waterforce_test_cases[] = {
+	KUNIT_CASE(waterforce_test_parse_status),
+	KUNIT_CASE(waterforce_test_repeated_status),
+	KUNIT_CASE(waterforce_test_parse_fw_ver),
+	KUNIT_CASE(waterforce_test_short_reports),
+	KUNIT_CASE(waterforce_test_completes_request),
+	KUNIT_CASE_SLOW(waterforce_test_bench_parse),
+	KUNIT_CASE_SLOW(waterforce_test_bench_cached_read),
+	KUNIT_CASE_SLOW(waterforce_test_bench_contended_read),
+	{}
+};
+
+static struct kunit_suite waterforce_test_suite = {
+	.name = "gigabyte_waterforce",
+	.init = waterforce_test_init,
+	.exit = waterforce_test_exit,
+	.test_cases = waterforce_test_cases,
+};
+
+kunit_test_suite(waterforce_test_suite);
@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Tracepoints for the gigabyte_waterforce driver
+ *
+ * Devices are identified by their HID id, which is the last part of their name on the HID bus.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gigabyte_waterforce
+
+#if !defined(_GIGABYTE_WATERFORCE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _GIGABYTE_WATERFORCE_TRACE_H
+
+#include <linux/hid.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(waterforce_cmd_submit,
+	TP_PROTO(struct hid_device *hdev, u8 opcode, int length),
+	TP_ARGS(hdev, opcode, length),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u8, opcode)
+		__field(int, length)
+	),
+
+	TP_fast_assign(
+		__entry->id = hdev->id;
+		__entry->opcode = opcode;
+		__entry->length = length;
+	),
+
+	TP_printk("id=%d opcode=0x%02x length=%d", __entry->id, __entry->opcode, __entry->length)
+);
+
+TRACE_EVENT(waterforce_cmd_done,
+	TP_PROTO(struct hid_device *hdev, u8 opcode, int ret),
+	TP_ARGS(hdev, opcode, ret),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u8, opcode)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__entry->id = hdev->id;
+		__entry->opcode = opcode;
+		__entry->ret = ret;
+	),
+
+	TP_printk("id=%d opcode=0x%02x ret=%d", __entry->id, __entry->opcode, __entry->ret)
+);
+
+TRACE_EVENT(waterforce_report,
+	TP_PROTO(struct hid_device *hdev, u8 opcode, int size),
+	TP_ARGS(hdev, opcode, size),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u8, opcode)
+		__field(int, size)
+	),
+
+	TP_fast_assign(
+		__entry->id = hdev->id;
+		__entry->opcode = opcode;
+		__entry->size = size;
+	),
+
+	TP_printk("id=%d opcode=0x%02x size=%d", __entry->id, __entry->opcode, __entry->size)
+);
+
+TRACE_EVENT(waterforce_status_cache,
+	TP_PROTO(struct hid_device *hdev, bool hit, unsigned int validity),
+	TP_ARGS(hdev, hit, validity),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(bool, hit)
+		__field(unsigned int, validity)
+	),
+
+	TP_fast_assign(
+		__entry->id = hdev->id;
+		__entry->hit = hit;
+		__entry->validity = validity;
+	),
+
+	TP_printk("id=%d %s validity=%ums", __entry->id, __entry->hit ? "hit" : "miss",
+		  __entry->validity)
+);
+
+TRACE_EVENT(waterforce_status_complete,
+	TP_PROTO(struct hid_device *hdev, int result),
+	TP_ARGS(hdev, result),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(int, result)
+	),
+
+	TP_fast_assign(
+		__entry->id = hdev->id;
+		__entry->result = result;
+	),
+
+	TP_printk("id=%d result=%d", __entry->id, __entry->result)
+);
+
+#endif /* _GIGABYTE_WATERFORCE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gigabyte_waterforce_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Load generator for the gigabyte_waterforce hwmon sysfs entries
+ *
+ * Spawns reader threads that keep re-reading one sysfs entry of a Waterforce hwmon device
+ * and reports the read latency percentiles, throughput and failures, so that the effect of
+ * changes to caching and request coalescing in the driver can be measured on real hardware.
+ *
+ * Usage: waterforce-load [-t threads] [-d seconds] [-a attribute] [hwmon directory]
+ *
+ * Without a directory, the first hwmon device named "waterforce" is used.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HWMON_CLASS	"/sys/class/hwmon"
+#define HWMON_NAME	"waterforce"
+
+/*
+ * Latencies are kept in a log-linear histogram: values below 2^SUB_BITS ns have a bucket
+ * each, while every power of two above that is split into 2^SUB_BITS buckets, which keeps
+ * the percentiles within about 6% of the actual value.
+ */
+#define SUB_BITS	4
+#define SUB_BUCKETS	(1 << SUB_BITS)
+#define BUCKETS		((64 - SUB_BITS + 1) * SUB_BUCKETS)
+
+#define ARRAY_SIZE(a)	((int)(sizeof(a) / sizeof((a)[0])))
+
+struct reader {
+	pthread_t thread;
+	uint64_t histogram[BUCKETS];
+	uint64_t reads;
+	uint64_t timeouts;
+	uint64_t errors;
+	uint64_t max_ns;
+};
+
+static char attr_path[4096];
+static struct timespec deadline;
+static volatile bool stop, failed;
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec_ns(&ts);
+}
+
+static int bucket_of(uint64_t ns)
+{
+	int exp;
+
+	if (ns < SUB_BUCKETS)
+		return ns;
+
+	exp = 63 - __builtin_clzll(ns);
+	return (exp - SUB_BITS + 1) * SUB_BUCKETS + ((ns >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+/* Returns the lowest value falling into the bucket */
+static uint64_t bucket_start(int bucket)
+{
+	int exp = bucket / SUB_BUCKETS + SUB_BITS - 1;
+
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+
+	return (1ULL << exp) | ((uint64_t)(bucket % SUB_BUCKETS) << (exp - SUB_BITS));
+}
+
+static void *reader_fn(void *arg)
+{
+	struct reader *reader = arg;
+	uint64_t end = timespec_ns(&deadline), start, elapsed;
+	char buf[64];
+	ssize_t ret;
+	int fd;
+
+	fd = open(attr_path, O_RDONLY);
+	if (fd < 0) {
+		perror(attr_path);
+		failed = true;
+		stop = true;
+		return NULL;
+	}
+
+	while (!stop) {
+		start = now_ns();
+		if (start >= end)
+			break;
+
+		/* Reading from the start makes sysfs call into the driver again */
+		ret = pread(fd, buf, sizeof(buf), 0);
+		elapsed = now_ns() - start;
+
+		reader->reads++;
+		reader->histogram[bucket_of(elapsed)]++;
+		if (elapsed > reader->max_ns)
+			reader->max_ns = elapsed;
+
+		if (ret < 0) {
+			if (errno == ETIMEDOUT)
+				reader->timeouts++;
+			else
+				reader->errors++;
+		}
+	}
+
+	close(fd);
+	return NULL;
+}
+
+/* Finds the first hwmon device registered by the driver */
+static int find_hwmon(char *path, size_t size)
+{
+	struct dirent *entry;
+	char name_path[4096], name[64];
+	int ret = -ENOENT;
+	DIR *dir;
+	FILE *f;
+
+	dir = opendir(HWMON_CLASS);
+	if (!dir)
+		return -errno;
+
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		snprintf(name_path, sizeof(name_path), HWMON_CLASS "/%s/name", entry->d_name);
+		f = fopen(name_path, "r");
+		if (!f)
+			continue;
+
+		if (fgets(name, sizeof(name), f) && !strcmp(strtok(name, "\n"), HWMON_NAME)) {
+			snprintf(path, size, HWMON_CLASS "/%s", entry->d_name);
+			ret = 0;
+		}
+		fclose(f);
+
+		if (!ret)
+			break;
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-t threads] [-d seconds] [-a attribute] [hwmon directory]\n"
+		"  -t  number of reader threads (default 16)\n"
+		"  -d  duration of the run in seconds (default 10)\n"
+		"  -a  sysfs entry to read (default temp1_input)\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	static const double percentiles[] = { 50, 90, 99, 99.9 };
+	const char *attr = "temp1_input";
+	int threads = 16, duration = 10;
+	uint64_t histogram[BUCKETS] = { 0 };
+	uint64_t reads = 0, timeouts = 0, errors = 0, max_ns = 0, seen, start, elapsed;
+	struct reader *readers;
+	char hwmon[4096];
+	int opt, ret, i, j;
+
+	while ((opt = getopt(argc, argv, "t:d:a:h")) != -1) {
+		switch (opt) {
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'a':
+			attr = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (threads < 1 || duration < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (optind < argc) {
+		snprintf(hwmon, sizeof(hwmon), "%s", argv[optind]);
+	} else if (find_hwmon(hwmon, sizeof(hwmon)) < 0) {
+		fprintf(stderr, "No hwmon device named " HWMON_NAME " found\n");
+		return 1;
+	}
+	ret = snprintf(attr_path, sizeof(attr_path), "%s/%s", hwmon, attr);
+	if (ret < 0 || (size_t)ret >= sizeof(attr_path)) {
+		fprintf(stderr, "Path too long\n");
+		return 1;
+	}
+
+	if (access(attr_path, R_OK)) {
+		perror(attr_path);
+		return 1;
+	}
+
+	readers = calloc(threads, sizeof(*readers));
+	if (!readers) {
+		perror("calloc");
+		return 1;
+	}
+
+	printf("Reading %s from %d threads for %d s\n", attr_path, threads, duration);
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	start = timespec_ns(&deadline);
+	deadline.tv_sec += duration;
+
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&readers[i].thread, NULL, reader_fn, &readers[i])) {
+			perror("pthread_create");
+			failed = true;
+			stop = true;
+			threads = i;
+			break;
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(readers[i].thread, NULL);
+
+		for (j = 0; j < BUCKETS; j++)
+			histogram[j] += readers[i].histogram[j];
+		reads += readers[i].reads;
+		timeouts += readers[i].timeouts;
+		errors += readers[i].errors;
+		if (readers[i].max_ns > max_ns)
+			max_ns = readers[i].max_ns;
+	}
+	elapsed = now_ns() - start;
+
+	printf("reads: %llu\n", (unsigned long long)reads);
+	printf("throughput: %.1f reads/s\n", reads * 1e9 / elapsed);
+	printf("timeouts: %llu\n", (unsigned long long)timeouts);
+	printf("errors: %llu\n", (unsigned long long)errors);
+
+	if (reads) {
+		for (i = 0; i < ARRAY_SIZE(percentiles); i++) {
+			seen = 0;
+			for (j = 0; j < BUCKETS; j++) {
+				seen += histogram[j];
+				if (seen * 100.0 >= reads * percentiles[i])
+					break;
+			}
+			printf("p%g: %.1f us\n", percentiles[i], bucket_start(j) / 1e3);
+		}
+		printf("max: %.1f us\n", max_ns / 1e3);
+	}
+
+	free(readers);
+	if (failed)
+		return 1;
+	return errors || timeouts ? 2 : 0;
+}